@@ -29,6 +29,8 @@ namespace zl::os {
 	// Need to define these for your platform
 	inline void* aligned_alloc(std::size_t alignment, std::size_t bytes) {}
 	inline void* alloc(std::size_t bytes) {}
+	/* May grow/shrink the block in place; on failure returns nullptr and leaves `ptr` untouched */
+	inline void* realloc_mem(void *ptr, std::size_t bytes) {}
 	inline void free_mem(void *ptr) {}
 }
 
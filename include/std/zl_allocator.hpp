@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2022, suncloudsmoon and the tree-cpp contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZL_ALLOCATOR_HPP
+#define ZL_ALLOCATOR_HPP
+
+#include <stddef.h>
+
+#include <cstdlib>
+
+namespace zl {
+	/* Types that can be moved to a new address with a plain memcpy (the source is then not destroyed).
+	   Defaults to trivially copyable types; specialize it for types such as owning pointers. */
+	template<typename T>
+	inline constexpr bool is_trivially_relocatable = __is_trivially_copyable(T);
+
+	/* GCC before 13 only has the older (clang-deprecated) __has_trivial_destructor() */
+#if __has_builtin(__is_trivially_destructible)
+	template<typename T>
+	inline constexpr bool is_trivially_destructible = __is_trivially_destructible(T);
+#else
+	template<typename T>
+	inline constexpr bool is_trivially_destructible = __has_trivial_destructor(T);
+#endif
+
+	/* Allocator on top of std::malloc()/std::aligned_alloc(). Besides allocate()/deallocate() it offers
+	   reallocate(), which containers use to grow trivially relocatable elements in place. */
+	template<typename T>
+	struct allocator {
+		using value_type = T;
+
+		constexpr allocator() noexcept = default;
+		template<typename Other>
+		constexpr allocator(const allocator<Other>&) noexcept {}
+
+		T* allocate(size_t n) noexcept {
+			if constexpr (alignof(T) > alignof(max_align_t)) {
+				const size_t bytes = (n * sizeof(T) + alignof(T) - 1) & ~(alignof(T) - 1);
+				return static_cast<T*>(std::aligned_alloc(alignof(T), bytes));
+			} else {
+				return static_cast<T*>(std::malloc(n * sizeof(T)));
+			}
+		}
+		void deallocate(T *ptr, size_t) noexcept { std::free(ptr); }
+		/* Resizes the block (in place when the heap allows it), returns nullptr on failure.
+		   The contents are moved bytewise, so only use it for trivially relocatable types. */
+		T* reallocate(T *ptr, size_t, size_t new_n) noexcept requires (alignof(T) <= alignof(max_align_t)) {
+			return static_cast<T*>(std::realloc(static_cast<void*>(ptr), new_n * sizeof(T)));
+		}
+
+		template<typename Other>
+		constexpr bool operator==(const allocator<Other>&) const noexcept { return true; }
+	};
+}
+
+#endif /* ZL_ALLOCATOR_HPP */
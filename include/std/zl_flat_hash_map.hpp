@@ -0,0 +1,445 @@
+/*
+ * Copyright (c) 2022, suncloudsmoon and the tree-cpp contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZL_FLAT_HASH_MAP_HPP
+#define ZL_FLAT_HASH_MAP_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+#include "zl_allocator.hpp"
+#include "zl_hash.hpp"
+
+#if defined __GNUC__ && defined X86 && defined __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace zl {
+	template<typename T = void>
+	struct equal_to {
+		constexpr bool operator()(const T &a, const T &b) const { return a == b; }
+	};
+	/* Transparent form, enables heterogeneous lookup when the hasher is transparent too */
+	template<>
+	struct equal_to<void> {
+		using is_transparent = void;
+		template<typename A, typename B>
+		constexpr bool operator()(const A &a, const B &b) const { return a == b; }
+	};
+
+	template<bool Cond, typename A, typename B> struct __conditional__ { using type = A; };
+	template<typename A, typename B> struct __conditional__<false, A, B> { using type = B; };
+
+	template<typename Key, typename Value>
+	struct map_entry {
+		Key first;
+		Value second;
+	};
+
+	/* Control bytes of the flat_hash_map: a full slot stores the low 7 bits of its hash (H2) */
+	namespace __ctrl__ {
+		constexpr int8_t empty = -128;
+		constexpr int8_t deleted = -2;
+		constexpr size_t group_width = 16;
+
+		/* All-empty group used by tables that haven't allocated yet */
+		alignas(16) inline constexpr int8_t empty_group[group_width] = {
+			empty, empty, empty, empty, empty, empty, empty, empty,
+			empty, empty, empty, empty, empty, empty, empty, empty
+		};
+
+		/* 16 control bytes looked at together, each match returns a bitmask of positions */
+		struct group {
+#if defined __GNUC__ && defined X86 && defined __SSE2__
+			explicit group(const int8_t *pos) noexcept : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos))) {}
+
+			uint32_t match(int8_t h2) const noexcept 
+			{ return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl))); }
+			uint32_t match_empty() const noexcept { return match(empty); }
+			/* empty and deleted are the only control bytes below -1 */
+			uint32_t match_empty_or_deleted() const noexcept 
+			{ return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), ctrl))); }
+
+			__m128i ctrl;
+#else
+			explicit group(const int8_t *pos) noexcept : ctrl(pos) {}
+
+			uint32_t match(int8_t h2) const noexcept {
+				uint32_t res = 0;
+				for (size_t i = 0; i < group_width; i++) { res |= static_cast<uint32_t>(ctrl[i] == h2) << i; }
+				return res;
+			}
+			uint32_t match_empty() const noexcept { return match(empty); }
+			uint32_t match_empty_or_deleted() const noexcept {
+				uint32_t res = 0;
+				for (size_t i = 0; i < group_width; i++) { res |= static_cast<uint32_t>(ctrl[i] < -1) << i; }
+				return res;
+			}
+
+			const int8_t *ctrl;
+#endif
+		};
+	}
+
+	/* Open-addressing hash map (Swiss table layout). Keys and values live inline in one slot array,
+	   control bytes are probed a group at a time. Pointers and iterators are invalidated by rehashing. */
+	template<typename Key, typename Value, typename Hash = hash<Key>, typename KeyEqual = equal_to<Key>>
+	class flat_hash_map {
+	public:
+		using key_type = Key;
+		using mapped_type = Value;
+		using value_type = map_entry<Key, Value>;
+		using size_type = size_t;
+		using hasher = Hash;
+		using key_equal = KeyEqual;
+
+		template<bool Const>
+		class basic_iterator {
+		public:
+			using value_type = flat_hash_map::value_type;
+			using reference = typename __conditional__<Const, const value_type&, value_type&>::type;
+			using pointer = typename __conditional__<Const, const value_type*, value_type*>::type;
+		public:
+			basic_iterator() noexcept : ctrl(nullptr), slot(nullptr), end(nullptr) {}
+			/* Conversion from iterator to const_iterator */
+			template<bool OtherConst> requires (Const && !OtherConst)
+			basic_iterator(const basic_iterator<OtherConst> &other) noexcept 
+				: ctrl(other.ctrl), slot(other.slot), end(other.end) {}
+
+			reference operator*() const noexcept { return *slot; }
+			pointer operator->() const noexcept { return slot; }
+			basic_iterator& operator++() noexcept {
+				ctrl++;
+				slot++;
+				skip_free();
+				return *this;
+			}
+			basic_iterator operator++(int) noexcept {
+				auto temp = *this;
+				++*this;
+				return temp;
+			}
+			bool operator==(const basic_iterator &other) const noexcept { return ctrl == other.ctrl; }
+			bool operator!=(const basic_iterator &other) const noexcept { return ctrl != other.ctrl; }
+		private:
+			friend class flat_hash_map;
+			friend class basic_iterator<true>;
+
+			basic_iterator(const int8_t *c, value_type *s, const int8_t *e) noexcept : ctrl(c), slot(s), end(e) {}
+			void skip_free() noexcept {
+				while (ctrl != end && *ctrl < 0) {
+					ctrl++;
+					slot++;
+				}
+			}
+
+			const int8_t *ctrl;
+			value_type *slot;
+			const int8_t *end;
+		};
+		using iterator = basic_iterator<false>;
+		using const_iterator = basic_iterator<true>;
+
+		struct insert_result {
+			iterator position;
+			bool inserted;
+		};
+	public:
+		flat_hash_map() noexcept : ctrl(const_cast<int8_t*>(__ctrl__::empty_group)), slots(nullptr), 
+									cap(0), elems(0), growth_left(0), hash_fn(), eq_fn() {}
+		explicit flat_hash_map(size_type bucket_count, const Hash &hf = Hash(), const KeyEqual &eq = KeyEqual())
+			: ctrl(const_cast<int8_t*>(__ctrl__::empty_group)), slots(nullptr), 
+				cap(0), elems(0), growth_left(0), hash_fn(hf), eq_fn(eq) { reserve(bucket_count); }
+		flat_hash_map(const flat_hash_map &other) : flat_hash_map(other.size(), other.hash_fn, other.eq_fn) {
+			for (const auto &entry : other) { try_emplace(entry.first, entry.second); }
+		}
+		flat_hash_map(flat_hash_map &&other) noexcept 
+			: ctrl(other.ctrl), slots(other.slots), cap(other.cap), elems(other.elems), growth_left(other.growth_left),
+				hash_fn(std::move(other.hash_fn)), eq_fn(std::move(other.eq_fn)) { other.reset_empty(); }
+		~flat_hash_map() { destroy(); }
+		flat_hash_map& operator=(const flat_hash_map &other) {
+			if (this != &other) {
+				flat_hash_map temp(other);
+				swap(temp);
+			}
+			return *this;
+		}
+		flat_hash_map& operator=(flat_hash_map &&other) noexcept {
+			if (this != &other) {
+				destroy();
+				ctrl = other.ctrl;
+				slots = other.slots;
+				cap = other.cap;
+				elems = other.elems;
+				growth_left = other.growth_left;
+				hash_fn = std::move(other.hash_fn);
+				eq_fn = std::move(other.eq_fn);
+				other.reset_empty();
+			}
+			return *this;
+		}
+
+		// Iterators
+		iterator begin() noexcept {
+			iterator it(ctrl, slots, ctrl + cap);
+			it.skip_free();
+			return it;
+		}
+		const_iterator begin() const noexcept { return const_cast<flat_hash_map*>(this)->begin(); }
+		const_iterator cbegin() const noexcept { return begin(); }
+		iterator end() noexcept { return iterator(ctrl + cap, slots + cap, ctrl + cap); }
+		const_iterator end() const noexcept { return const_cast<flat_hash_map*>(this)->end(); }
+		const_iterator cend() const noexcept { return end(); }
+
+		// Capacity
+		bool empty() const noexcept { return !elems; }
+		size_type size() const noexcept { return elems; }
+		size_type capacity() const noexcept { return cap; }
+		hasher hash_function() const { return hash_fn; }
+		key_equal key_eq() const { return eq_fn; }
+
+		// Modifiers
+		void clear() noexcept {
+			if (!cap) return;
+			destroy_slots();
+			for (size_t i = 0; i < cap + __ctrl__::group_width; i++) { ctrl[i] = __ctrl__::empty; }
+			elems = 0;
+			growth_left = max_load(cap);
+		}
+		/* Makes room for at least `n` elements without rehashing */
+		void reserve(size_type n) {
+			if (n <= elems + growth_left) return;
+			size_t new_cap = __ctrl__::group_width;
+			while (max_load(new_cap) < n) { new_cap *= 2; }
+			resize(new_cap);
+		}
+		/* Rebuilds the table in place, dropping tombstones (shrinks when `n` allows it) */
+		void rehash(size_type n = 0) {
+			if (n < elems) n = elems;
+			if (!n) {
+				destroy();
+				reset_empty();
+				return;
+			}
+			size_t new_cap = __ctrl__::group_width;
+			while (max_load(new_cap) < n) { new_cap *= 2; }
+			resize(new_cap);
+		}
+
+		template<typename... Args>
+		insert_result try_emplace(const key_type &key, Args&&... args) 
+		{ return emplace_key(key, std::forward<Args>(args)...); }
+		template<typename... Args>
+		insert_result try_emplace(key_type &&key, Args&&... args) 
+		{ return emplace_key(std::move(key), std::forward<Args>(args)...); }
+		template<typename V>
+		insert_result insert_or_assign(const key_type &key, V &&value) {
+			auto res = emplace_key(key, std::forward<V>(value));
+			if (!res.inserted) res.position->second = std::forward<V>(value);
+			return res;
+		}
+		template<typename V>
+		insert_result insert_or_assign(key_type &&key, V &&value) {
+			auto res = emplace_key(std::move(key), std::forward<V>(value));
+			if (!res.inserted) res.position->second = std::forward<V>(value);
+			return res;
+		}
+		mapped_type& operator[](const key_type &key) { return emplace_key(key).position->second; }
+		mapped_type& operator[](key_type &&key) { return emplace_key(std::move(key)).position->second; }
+
+		void erase(const_iterator pos) noexcept { erase_at(static_cast<size_t>(pos.ctrl - ctrl)); }
+		void erase(iterator pos) noexcept { erase_at(static_cast<size_t>(pos.ctrl - ctrl)); }
+		size_type erase(const key_type &key) { return erase_key(key); }
+		template<typename K> requires requires { typename Hash::is_transparent; typename KeyEqual::is_transparent; }
+		size_type erase(const K &key) { return erase_key(key); }
+
+		void swap(flat_hash_map &other) noexcept {
+			flat_hash_map temp(std::move(other));
+			other = std::move(*this);
+			*this = std::move(temp);
+		}
+
+		// Lookup
+		iterator find(const key_type &key) { return find_key(key); }
+		const_iterator find(const key_type &key) const { return const_cast<flat_hash_map*>(this)->find_key(key); }
+		template<typename K> requires requires { typename Hash::is_transparent; typename KeyEqual::is_transparent; }
+		iterator find(const K &key) { return find_key(key); }
+		template<typename K> requires requires { typename Hash::is_transparent; typename KeyEqual::is_transparent; }
+		const_iterator find(const K &key) const { return const_cast<flat_hash_map*>(this)->find_key(key); }
+
+		bool contains(const key_type &key) const { return find(key) != end(); }
+		template<typename K> requires requires { typename Hash::is_transparent; typename KeyEqual::is_transparent; }
+		bool contains(const K &key) const { return find(key) != end(); }
+		size_type count(const key_type &key) const { return contains(key); }
+		template<typename K> requires requires { typename Hash::is_transparent; typename KeyEqual::is_transparent; }
+		size_type count(const K &key) const { return contains(key); }
+	private:
+		/* Keeps the load factor at 7/8 */
+		static constexpr size_t max_load(size_t capacity) noexcept { return capacity - capacity / 8; }
+		static constexpr int8_t h2(size_t hash) noexcept { return static_cast<int8_t>(hash & 0x7f); }
+		static constexpr size_t h1(size_t hash) noexcept { return hash >> 7; }
+
+		void set_ctrl(size_t index, int8_t h) noexcept {
+			ctrl[index] = h;
+			/* The first group is mirrored past the end so that unaligned group loads can wrap around */
+			if (index < __ctrl__::group_width) ctrl[cap + index] = h;
+		}
+
+		template<typename K>
+		iterator find_key(const K &key) {
+			if (!elems) return end();
+			return find_key(key, hash_fn(key));
+		}
+		template<typename K>
+		iterator find_key(const K &key, size_t hash) {
+			const size_t mask = cap - 1;
+			size_t pos = h1(hash) & mask;
+			/* The match is almost always in the first group, start pulling its slots in alongside the control bytes */
+			__builtin_prefetch(slots + pos);
+			for (size_t stride = __ctrl__::group_width; ; stride += __ctrl__::group_width) {
+				const __ctrl__::group g(ctrl + pos);
+				for (uint32_t match = g.match(h2(hash)); match; match &= match - 1) {
+					const size_t index = (pos + __builtin_ctz(match)) & mask;
+					if (eq_fn(slots[index].first, key)) return iterator(ctrl + index, slots + index, ctrl + cap);
+				}
+				if (g.match_empty()) return end();
+				pos = (pos + stride) & mask;
+			}
+		}
+		/* First empty or deleted slot on the probe sequence of `hash` (there always is one) */
+		size_t find_free(size_t hash) const noexcept {
+			const size_t mask = cap - 1;
+			size_t pos = h1(hash) & mask;
+			for (size_t stride = __ctrl__::group_width; ; stride += __ctrl__::group_width) {
+				if (uint32_t free = __ctrl__::group(ctrl + pos).match_empty_or_deleted()) 
+					return (pos + __builtin_ctz(free)) & mask;
+				pos = (pos + stride) & mask;
+			}
+		}
+
+		template<typename K, typename... Args>
+		insert_result emplace_key(K &&key, Args&&... args) {
+			const size_t hash = hash_fn(key);
+			if (elems) {
+				iterator it = find_key(key, hash);
+				if (it != end()) return { it, false };
+			}
+
+			if (!growth_left) {
+				/* Mostly tombstones -> clean them up in place, otherwise double */
+				if (cap && elems <= max_load(cap) / 2) resize(cap);
+				else resize(cap ? cap * 2 : __ctrl__::group_width);
+			}
+			const size_t index = find_free(hash);
+			growth_left -= (ctrl[index] == __ctrl__::empty);
+			set_ctrl(index, h2(hash));
+			new (slots + index) value_type{ Key(std::forward<K>(key)), Value(std::forward<Args>(args)...) };
+			elems++;
+			return { iterator(ctrl + index, slots + index, ctrl + cap), true };
+		}
+
+		template<typename K>
+		size_type erase_key(const K &key) {
+			iterator it = find_key(key);
+			if (it == end()) return 0;
+			erase_at(static_cast<size_t>(it.ctrl - ctrl));
+			return 1;
+		}
+		void erase_at(size_t index) noexcept {
+			slots[index].~value_type();
+			elems--;
+			/* If an empty slot is within one group on both sides, no probe sequence ever walked past
+			   this slot, so it can go back to empty instead of becoming a tombstone */
+			const size_t before = (index - __ctrl__::group_width) & (cap - 1);
+			const uint32_t empty_before = __ctrl__::group(ctrl + before).match_empty();
+			const uint32_t empty_after = __ctrl__::group(ctrl + index).match_empty();
+			const bool never_full = empty_before && empty_after 
+				&& static_cast<size_t>(__builtin_clz(empty_before << 16) + __builtin_ctz(empty_after)) < __ctrl__::group_width;
+			set_ctrl(index, never_full ? __ctrl__::empty : __ctrl__::deleted);
+			growth_left += never_full;
+		}
+
+		/* Moves every element into a fresh table of `new_cap` slots (a power of two, at least one group) */
+		void resize(size_t new_cap) {
+			int8_t *old_ctrl = ctrl;
+			value_type *old_slots = slots;
+			const size_t old_cap = cap;
+
+			allocate(new_cap);
+			for (size_t i = 0; i < old_cap; i++) {
+				if (old_ctrl[i] < 0) continue;
+				const size_t hash = hash_fn(old_slots[i].first);
+				const size_t index = find_free(hash);
+				set_ctrl(index, h2(hash));
+				new (slots + index) value_type(std::move(old_slots[i]));
+				old_slots[i].~value_type();
+			}
+			growth_left = max_load(cap) - elems;
+			if (old_cap) std::free(old_ctrl);
+		}
+		/* Control bytes and slots share one allocation: [ctrl | mirrored group | pad | slots] */
+		void allocate(size_t new_cap) {
+			constexpr size_t align = (alignof(value_type) > 16) ? alignof(value_type) : 16;
+			const size_t slot_offset = (new_cap + __ctrl__::group_width + align - 1) & ~(align - 1);
+			const size_t bytes = (slot_offset + new_cap * sizeof(value_type) + align - 1) & ~(align - 1);
+			void *mem = std::aligned_alloc(align, bytes);
+			if (!mem) std::abort();
+			ctrl = static_cast<int8_t*>(mem);
+			slots = reinterpret_cast<value_type*>(static_cast<unsigned char*>(mem) + slot_offset);
+			cap = new_cap;
+			for (size_t i = 0; i < cap + __ctrl__::group_width; i++) { ctrl[i] = __ctrl__::empty; }
+		}
+		void destroy_slots() noexcept {
+			if constexpr (!is_trivially_destructible<value_type>) {
+				for (size_t i = 0; i < cap; i++) { if (ctrl[i] >= 0) slots[i].~value_type(); }
+			}
+		}
+		void destroy() noexcept {
+			if (!cap) return;
+			destroy_slots();
+			std::free(ctrl);
+		}
+		void reset_empty() noexcept {
+			ctrl = const_cast<int8_t*>(__ctrl__::empty_group);
+			slots = nullptr;
+			cap = 0;
+			elems = 0;
+			growth_left = 0;
+		}
+	private:
+		int8_t *ctrl;
+		value_type *slots;
+		size_t cap;
+		size_t elems;
+		size_t growth_left;
+		hasher hash_fn;
+		key_equal eq_fn;
+	};
+
+	template<typename Key, typename Value, typename Hash, typename KeyEqual>
+	inline void swap(flat_hash_map<Key, Value, Hash, KeyEqual> &f, flat_hash_map<Key, Value, Hash, KeyEqual> &s) noexcept {
+		f.swap(s);
+	}
+}
+
+#endif /* ZL_FLAT_HASH_MAP_HPP */
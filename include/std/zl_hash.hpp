@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2022, suncloudsmoon and the tree-cpp contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZL_HASH_HPP
+#define ZL_HASH_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "os.hpp"
+
+#if defined __GNUC__ && defined X86
+#if defined __AVX2__
+#include <immintrin.h>
+#elif defined __SSE2__
+#include <emmintrin.h>
+#endif
+#endif
+
+namespace {
+	/* wyhash primes, used for the multiply-mix of short keys */
+	constexpr uint64_t __hash_prime__[4] = {
+		0xa0761d6478bd642f, 0xe7037ed1a0b428db, 0x8ebc6af09c88c6e3, 0x589965cc75374cc3
+	};
+	constexpr uint64_t __hash_prime32__ = 0x9e3779b1;
+	/* Per-lane keys of the long key accumulator (each stripe uses the window starting at its index) */
+	constexpr uint64_t __hash_secret__[24] = {
+		0x7473dd04cc3d72ee, 0x4b7d58fb1c8969d3, 0xa1a2583a2200808a,
+		0x0c8c072dfeeabbc4, 0x49f9c543f03c5557, 0xb8e6e7fdb99a2351,
+		0x1733bd2ca099c93f, 0x89669f803f31545b, 0xea65e8d477e6a393,
+		0x8d217fca05ff6cbb, 0xc6c8a347469c26b7, 0x0d0d8ae75a146137,
+		0x48d30412f0b49c1e, 0x1cee3074e4a9ded7, 0xda30f6355d9709e9,
+		0x58e90d95d5e8cd04, 0xb6f94e17f64f284d, 0x99b8e20716e889db,
+		0xefcb3c36d8b401d2, 0xb0252d4271fa3354, 0x9d9c3468ec966a37,
+		0x915556e8cdf6dffd, 0x175adc539d82bc1c, 0x451c99f45050a778
+	};
+	constexpr size_t __hash_stripe_len__ = 64;
+	constexpr size_t __hash_block_stripes__ = 16;
+	/* Keys of this length or longer go through the lane accumulator */
+	constexpr size_t __hash_long_len__ = 256;
+
+	inline constexpr void __hash_mum__(uint64_t &a, uint64_t &b) {
+#ifdef __SIZEOF_INT128__
+		const unsigned __int128 res = static_cast<unsigned __int128>(a) * b;
+		a = static_cast<uint64_t>(res);
+		b = static_cast<uint64_t>(res >> 64);
+#else
+		/* 64x64 -> 128 bit product out of four 32-bit multiplies (e.g. on 32-bit x86) */
+		const uint64_t a_hi = a >> 32, a_lo = static_cast<uint32_t>(a);
+		const uint64_t b_hi = b >> 32, b_lo = static_cast<uint32_t>(b);
+		const uint64_t hi = a_hi * b_hi, mid0 = a_hi * b_lo, mid1 = a_lo * b_hi, lo = a_lo * b_lo;
+		const uint64_t t = lo + (mid0 << 32);
+		uint64_t carry = (t < lo);
+		const uint64_t res_lo = t + (mid1 << 32);
+		carry += (res_lo < t);
+		a = res_lo;
+		b = hi + (mid0 >> 32) + (mid1 >> 32) + carry;
+#endif
+	}
+	inline constexpr uint64_t __hash_mix__(uint64_t a, uint64_t b) {
+		__hash_mum__(a, b);
+		return a ^ b;
+	}
+
+	/* Little-endian loads written byte by byte so that they also work in constant expressions
+	   (GCC merges them into a single unaligned load) */
+	template<typename Byte>
+	inline constexpr uint64_t __hash_read32__(const Byte *p) {
+		return static_cast<uint64_t>(static_cast<unsigned char>(p[0]))
+				| (static_cast<uint64_t>(static_cast<unsigned char>(p[1])) << 8)
+				| (static_cast<uint64_t>(static_cast<unsigned char>(p[2])) << 16)
+				| (static_cast<uint64_t>(static_cast<unsigned char>(p[3])) << 24);
+	}
+	template<typename Byte>
+	inline constexpr uint64_t __hash_read64__(const Byte *p) {
+		return __hash_read32__(p) | (__hash_read32__(p + 4) << 32);
+	}
+
+#if defined __GNUC__ && defined X86 && defined __AVX2__
+	inline void __hash_accumulate_simd__(uint64_t *acc, const void *src, const uint64_t *secret) {
+		__m256i *xacc = reinterpret_cast<__m256i*>(acc);
+		const __m256i *xsrc = reinterpret_cast<const __m256i*>(src);
+		const __m256i *xsecret = reinterpret_cast<const __m256i*>(secret);
+		for (size_t i = 0; i < 2; i++) {
+			const __m256i data = _mm256_loadu_si256(xsrc + i);
+			const __m256i key = _mm256_xor_si256(data, _mm256_loadu_si256(xsecret + i));
+			const __m256i key_hi = _mm256_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1));
+			const __m256i product = _mm256_mul_epu32(key, key_hi);
+			const __m256i swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+			xacc[i] = _mm256_add_epi64(xacc[i], _mm256_add_epi64(product, swapped));
+		}
+	}
+	inline void __hash_scramble_simd__(uint64_t *acc, const uint64_t *secret) {
+		__m256i *xacc = reinterpret_cast<__m256i*>(acc);
+		const __m256i *xsecret = reinterpret_cast<const __m256i*>(secret);
+		const __m256i prime = _mm256_set1_epi32(static_cast<int>(__hash_prime32__));
+		for (size_t i = 0; i < 2; i++) {
+			__m256i a = _mm256_xor_si256(xacc[i], _mm256_srli_epi64(xacc[i], 47));
+			a = _mm256_xor_si256(a, _mm256_loadu_si256(xsecret + i));
+			const __m256i a_hi = _mm256_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1));
+			const __m256i lo = _mm256_mul_epu32(a, prime);
+			const __m256i hi = _mm256_mul_epu32(a_hi, prime);
+			xacc[i] = _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+		}
+	}
+	#define ZL_HASH_SIMD
+#elif defined __GNUC__ && defined X86 && defined __SSE2__
+	inline void __hash_accumulate_simd__(uint64_t *acc, const void *src, const uint64_t *secret) {
+		__m128i *xacc = reinterpret_cast<__m128i*>(acc);
+		const __m128i *xsrc = reinterpret_cast<const __m128i*>(src);
+		const __m128i *xsecret = reinterpret_cast<const __m128i*>(secret);
+		for (size_t i = 0; i < 4; i++) {
+			const __m128i data = _mm_loadu_si128(xsrc + i);
+			const __m128i key = _mm_xor_si128(data, _mm_loadu_si128(xsecret + i));
+			const __m128i key_hi = _mm_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1));
+			const __m128i product = _mm_mul_epu32(key, key_hi);
+			const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+			xacc[i] = _mm_add_epi64(xacc[i], _mm_add_epi64(product, swapped));
+		}
+	}
+	inline void __hash_scramble_simd__(uint64_t *acc, const uint64_t *secret) {
+		__m128i *xacc = reinterpret_cast<__m128i*>(acc);
+		const __m128i *xsecret = reinterpret_cast<const __m128i*>(secret);
+		const __m128i prime = _mm_set1_epi32(static_cast<int>(__hash_prime32__));
+		for (size_t i = 0; i < 4; i++) {
+			__m128i a = _mm_xor_si128(xacc[i], _mm_srli_epi64(xacc[i], 47));
+			a = _mm_xor_si128(a, _mm_loadu_si128(xsecret + i));
+			const __m128i a_hi = _mm_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1));
+			const __m128i lo = _mm_mul_epu32(a, prime);
+			const __m128i hi = _mm_mul_epu32(a_hi, prime);
+			xacc[i] = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+		}
+	}
+	#define ZL_HASH_SIMD
+#endif
+
+	/* Adds one 64-byte stripe into the eight 64-bit lanes. The scalar path is the reference
+	   and is also what runs during constant evaluation; the SIMD paths compute the same thing */
+	template<typename Byte>
+	inline constexpr void __hash_accumulate__(uint64_t *acc, const Byte *p, const uint64_t *secret) {
+#ifdef ZL_HASH_SIMD
+		if (!__builtin_is_constant_evaluated()) {
+			__hash_accumulate_simd__(acc, p, secret);
+			return;
+		}
+#endif
+		for (size_t i = 0; i < 8; i++) {
+			const uint64_t data = __hash_read64__(p + 8 * i);
+			const uint64_t key = data ^ secret[i];
+			acc[i ^ 1] += data;
+			acc[i] += (key & 0xffffffff) * (key >> 32);
+		}
+	}
+	inline constexpr void __hash_scramble__(uint64_t *acc, const uint64_t *secret) {
+#ifdef ZL_HASH_SIMD
+		if (!__builtin_is_constant_evaluated()) {
+			__hash_scramble_simd__(acc, secret);
+			return;
+		}
+#endif
+		for (size_t i = 0; i < 8; i++) {
+			uint64_t a = acc[i];
+			a ^= a >> 47;
+			a ^= secret[i];
+			acc[i] = a * __hash_prime32__;
+		}
+	}
+
+	template<typename Byte>
+	inline constexpr uint64_t __hash_long__(const Byte *p, size_t len, uint64_t seed) {
+		uint64_t secret[24] = {};
+		for (size_t i = 0; i < 24; i++) 
+		{ secret[i] = __hash_secret__[i] + ((i & 1) ? -seed : seed); }
+		alignas(32) uint64_t acc[8] = {
+			__hash_prime__[0], __hash_prime__[1], __hash_prime__[2], __hash_prime__[3],
+			~__hash_prime__[0], ~__hash_prime__[1], ~__hash_prime__[2], ~__hash_prime__[3]
+		};
+
+		constexpr size_t block_len = __hash_stripe_len__ * __hash_block_stripes__;
+		const size_t blocks = (len - 1) / block_len;
+		for (size_t b = 0; b < blocks; b++) {
+			for (size_t s = 0; s < __hash_block_stripes__; s++) 
+			{ __hash_accumulate__(acc, p + b * block_len + s * __hash_stripe_len__, secret + s); }
+			__hash_scramble__(acc, secret + __hash_block_stripes__);
+		}
+		const size_t stripes = ((len - 1) - blocks * block_len) / __hash_stripe_len__;
+		for (size_t s = 0; s < stripes; s++)
+		{ __hash_accumulate__(acc, p + blocks * block_len + s * __hash_stripe_len__, secret + s); }
+		/* The last stripe always ends at the end of the key (it may overlap the previous one) */
+		__hash_accumulate__(acc, p + len - __hash_stripe_len__, secret + 7);
+
+		uint64_t res = len * __hash_prime__[0];
+		for (size_t i = 0; i < 4; i++) 
+		{ res += __hash_mix__(acc[2 * i] ^ secret[2 * i + 3], acc[2 * i + 1] ^ secret[2 * i + 4]); }
+		return __hash_mix__(res ^ __hash_prime__[2], __hash_prime__[1]);
+	}
+
+	template<typename Byte>
+	inline constexpr uint64_t __hash_bytes__(const Byte *p, size_t len, uint64_t seed) {
+		if (len >= __hash_long_len__) return __hash_long__(p, len, seed);
+		seed ^= __hash_mix__(seed ^ __hash_prime__[0], __hash_prime__[1]);
+		uint64_t a = 0, b = 0;
+		if (len <= 16) {
+			if (len >= 4) {
+				/* Two (possibly overlapping) 4-byte reads from each end cover every length in 4..16 */
+				const size_t off = (len >> 3) << 2;
+				a = (__hash_read32__(p) << 32) | __hash_read32__(p + off);
+				b = (__hash_read32__(p + len - 4) << 32) | __hash_read32__(p + len - 4 - off);
+			} else if (len > 0) {
+				a = (static_cast<uint64_t>(static_cast<unsigned char>(p[0])) << 16)
+					| (static_cast<uint64_t>(static_cast<unsigned char>(p[len >> 1])) << 8)
+					| static_cast<uint64_t>(static_cast<unsigned char>(p[len - 1]));
+			}
+		} else {
+			size_t i = len;
+			if (i > 48) {
+				uint64_t seed1 = seed, seed2 = seed;
+				do {
+					seed = __hash_mix__(__hash_read64__(p) ^ __hash_prime__[1], __hash_read64__(p + 8) ^ seed);
+					seed1 = __hash_mix__(__hash_read64__(p + 16) ^ __hash_prime__[2], __hash_read64__(p + 24) ^ seed1);
+					seed2 = __hash_mix__(__hash_read64__(p + 32) ^ __hash_prime__[3], __hash_read64__(p + 40) ^ seed2);
+					p += 48;
+					i -= 48;
+				} while (i > 48);
+				seed ^= seed1 ^ seed2;
+			}
+			while (i > 16) {
+				seed = __hash_mix__(__hash_read64__(p) ^ __hash_prime__[1], __hash_read64__(p + 8) ^ seed);
+				p += 16;
+				i -= 16;
+			}
+			/* Last 16 bytes of the key (reaches back into already mixed bytes when i < 16) */
+			a = __hash_read64__(p + i - 16);
+			b = __hash_read64__(p + i - 8);
+		}
+		a ^= __hash_prime__[1];
+		b ^= seed;
+		__hash_mum__(a, b);
+		return __hash_mix__(a ^ __hash_prime__[0] ^ len, b ^ __hash_prime__[1]);
+	}
+
+	consteval size_t __hash_strlen__(const char *str) {
+		if (!str) return 0;
+		size_t index = 0;
+		for (; str[index]; index++);
+		return index;
+	}
+}
+
+// Hashing (ZL library extensions)
+namespace zl {
+	/* Fast non-cryptographic hash of a byte range. Results are the same across SIMD/scalar builds
+	   and between compile time and run time, but are not stable across library versions. */
+	inline uint64_t hash_bytes(const void *src, size_t bytes, uint64_t seed = 0) noexcept {
+		/* NULL checking -> hashed as an empty key */
+		if (!src) bytes = 0;
+		return __hash_bytes__(static_cast<const unsigned char*>(src), bytes, seed);
+	}
+	/* Character overload, folds at compile time when the key is a constant */
+	inline constexpr uint64_t hash_bytes(const char *src, size_t bytes, uint64_t seed = 0) noexcept {
+		if (!src) bytes = 0;
+		return __hash_bytes__(src, bytes, seed);
+	}
+	/* Hashes a null-terminated string literal during compilation (e.g. for switch labels) */
+	consteval uint64_t eval_hash(const char *str, uint64_t seed = 0) {
+		return __hash_bytes__(str, __hash_strlen__(str), seed);
+	}
+
+	/* Hash function object, specialize it for your own key types */
+	template<typename T>
+	struct hash;
+
+	template<typename T>
+	struct __hash_integral__ {
+		constexpr size_t operator()(T x) const noexcept {
+			return __hash_mix__(static_cast<uint64_t>(x) ^ __hash_prime__[0], __hash_prime__[1]);
+		}
+	};
+	template<> struct hash<bool> : __hash_integral__<bool> {};
+	template<> struct hash<char> : __hash_integral__<char> {};
+	template<> struct hash<signed char> : __hash_integral__<signed char> {};
+	template<> struct hash<unsigned char> : __hash_integral__<unsigned char> {};
+	template<> struct hash<char8_t> : __hash_integral__<char8_t> {};
+	template<> struct hash<char16_t> : __hash_integral__<char16_t> {};
+	template<> struct hash<char32_t> : __hash_integral__<char32_t> {};
+	template<> struct hash<wchar_t> : __hash_integral__<wchar_t> {};
+	template<> struct hash<short> : __hash_integral__<short> {};
+	template<> struct hash<unsigned short> : __hash_integral__<unsigned short> {};
+	template<> struct hash<int> : __hash_integral__<int> {};
+	template<> struct hash<unsigned int> : __hash_integral__<unsigned int> {};
+	template<> struct hash<long> : __hash_integral__<long> {};
+	template<> struct hash<unsigned long> : __hash_integral__<unsigned long> {};
+	template<> struct hash<long long> : __hash_integral__<long long> {};
+	template<> struct hash<unsigned long long> : __hash_integral__<unsigned long long> {};
+
+	/* GCC before 11 has no __builtin_bit_cast(), floating-point keys then only hash at run time */
+#if __has_builtin(__builtin_bit_cast)
+	#define ZL_HASH_FLOAT_CONSTEXPR constexpr
+	template<typename U, typename F>
+	constexpr U __float_bits__(F x) noexcept { return __builtin_bit_cast(U, x); }
+#else
+	#define ZL_HASH_FLOAT_CONSTEXPR
+	template<typename U, typename F>
+	inline U __float_bits__(F x) noexcept {
+		U bits;
+		__builtin_memcpy(&bits, &x, sizeof(bits));
+		return bits;
+	}
+#endif
+
+	template<>
+	struct hash<float> {
+		ZL_HASH_FLOAT_CONSTEXPR size_t operator()(float x) const noexcept {
+			/* +0.0 and -0.0 compare equal, so they must hash equal */
+			const uint32_t bits = (x == 0) ? 0 : __float_bits__<uint32_t>(x);
+			return __hash_integral__<uint32_t>{}(bits);
+		}
+	};
+	template<>
+	struct hash<double> {
+		ZL_HASH_FLOAT_CONSTEXPR size_t operator()(double x) const noexcept {
+			const uint64_t bits = (x == 0) ? 0 : __float_bits__<uint64_t>(x);
+			return __hash_integral__<uint64_t>{}(bits);
+		}
+	};
+
+	template<typename T>
+	struct hash<T*> {
+		size_t operator()(T *ptr) const noexcept {
+			return __hash_integral__<uintptr_t>{}(reinterpret_cast<uintptr_t>(ptr));
+		}
+	};
+}
+
+#endif /* ZL_HASH_HPP */
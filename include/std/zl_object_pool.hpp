@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2022, suncloudsmoon and the tree-cpp contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZL_OBJECT_POOL_HPP
+#define ZL_OBJECT_POOL_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+#include "zl_unique_ptr.hpp"
+
+#ifndef __GNUC__
+#error "zl::object_pool needs the __atomic builtins of GCC/Clang!"
+#endif
+
+namespace zl {
+	/* Specialize to true for types whose state the caller fully resets before reuse (e.g. packet
+	   descriptors). Their objects are constructed once when the pool grows and destroyed with the pool,
+	   so acquire()/release() skip the constructor and destructor. */
+	template<typename T>
+	inline constexpr bool is_trivially_resettable = false;
+
+	template<typename T>
+	class object_pool;
+
+	/* Deleter that hands the object back to the pool it came from */
+	template<typename T>
+	struct pool_delete {
+		void operator()(T *ptr) const noexcept { pool->release(ptr); }
+
+		object_pool<T> *pool = nullptr;
+	};
+
+	/* `next_batch` is read by other threads while they pop the shared stack, so it never overlaps the
+	   object. The thread-private links may live in the object's storage, unless the object has to
+	   survive in the pool. */
+	template<typename T, bool Resettable>
+	struct __pool_node__ {
+		struct link_type {
+			__pool_node__ *next;
+			size_t count;
+		};
+		__pool_node__ *next_batch;
+		union {
+			link_type link;
+			alignas(T) unsigned char storage[sizeof(T)];
+		};
+	};
+	template<typename T>
+	struct __pool_node__<T, true> {
+		struct link_type {
+			__pool_node__ *next;
+			size_t count;
+		};
+		__pool_node__ *next_batch;
+		link_type link;
+		alignas(T) unsigned char storage[sizeof(T)];
+	};
+
+	/* Fixed-size object pool. Each thread allocates from and frees into its own free list for the pool;
+	   surplus batches move between threads through a lock-free stack whose head carries an ABA tag in
+	   the upper 16 bits. Node addresses must be canonical 48-bit ones (4-level paging), lower half
+	   (user space) or upper half (kernel); with 5-level paging (LA57) the pool aborts on the first
+	   node it cannot tag.
+	   The memory is owned by a reference-counted core shared by the pool and by every thread cache
+	   holding nodes of it, so the pool may be destroyed while other threads still have caches for it:
+	   those are dropped the next time the thread uses a pool of the same type, or when it exits. */
+	template<typename T>
+	class object_pool {
+		static_assert(sizeof(void*) == 8, "[zl::object_pool<T> error] -> the tagged free stack needs 64-bit pointers!");
+	public:
+		using value_type = T;
+		using deleter_type = pool_delete<T>;
+		using handle = std::unique_ptr<T, pool_delete<T>>;
+	public:
+		/* `batch` objects are allocated at a time and moved between threads at a time */
+		explicit object_pool(size_t batch = 64) : core(make_core(batch ? batch : 1)) {}
+		object_pool(const object_pool&) = delete;
+		object_pool& operator=(const object_pool&) = delete;
+		~object_pool() {
+			__atomic_store_n(&core->alive, false, __ATOMIC_RELEASE);
+			/* This thread's cache is dropped right away, other threads drop theirs lazily */
+			if (tls_state == cache_state::live) {
+				for (cache_entry &e : tls.entries) { if (e.core == core) drop(e); }
+			}
+			release_core(core);
+		}
+
+		/* Hands out an object (constructed from `args`, or recycled as-is for resettable types) */
+		template<typename... Args>
+		T* acquire(Args&&... args) {
+			cache_entry &c = local_entry();
+			node *n = c.head;
+			if (!n) n = refill(c);
+			c.head = n->link.next;
+			c.count--;
+			T *obj = reinterpret_cast<T*>(n->storage);
+			if constexpr (resettable) {
+				if constexpr (sizeof...(Args) > 0) *obj = T(std::forward<Args>(args)...);
+			} else {
+				new (obj) T(std::forward<Args>(args)...);
+			}
+			return obj;
+		}
+		void release(T *ptr) noexcept {
+			if (!ptr) return;
+			if constexpr (!resettable) ptr->~T();
+			node *n = reinterpret_cast<node*>(reinterpret_cast<unsigned char*>(ptr) - offsetof(node, storage));
+			cache_entry &c = local_entry();
+			n->link.next = c.head;
+			c.head = n;
+			if (++c.count >= 2 * core->batch_size) give_back_tail(c);
+		}
+		template<typename... Args>
+		handle make(Args&&... args) { return handle(acquire(std::forward<Args>(args)...), pool_delete<T>{ this }); }
+	private:
+		static constexpr bool resettable = is_trivially_resettable<T>;
+		using node = __pool_node__<T, resettable>;
+
+		struct chunk {
+			node* nodes() noexcept { return reinterpret_cast<node*>(reinterpret_cast<unsigned char*>(this) + nodes_offset); }
+
+			chunk *next;
+			size_t count;
+		};
+		static constexpr size_t node_align = (alignof(node) > alignof(chunk)) ? alignof(node) : alignof(chunk);
+		static constexpr size_t nodes_offset = (sizeof(chunk) + node_align - 1) & ~(node_align - 1);
+
+		/* Everything other threads may still reach after the pool object is gone */
+		struct shared_core {
+			alignas(64) uint64_t free_head;
+			chunk *chunks;
+			size_t batch_size;
+			size_t refs;
+			bool alive;
+		};
+
+		struct cache_entry {
+			shared_core *core = nullptr;
+			node *head = nullptr;
+			size_t count = 0;
+		};
+		/* Per-thread caches of the pools of this type, one entry per pool */
+		struct thread_cache {
+			static constexpr size_t size = 8;
+
+			~thread_cache() {
+				for (cache_entry &e : entries) { if (e.core) drop(e); }
+				tls_state = cache_state::destroyed;
+			}
+
+			cache_entry entries[size];
+			size_t last = 0;
+			size_t victim = 0;
+		};
+		enum class cache_state : unsigned char { unused, live, destroyed };
+		static inline thread_local thread_cache tls;
+		/* Trivially destructible, so it can still be checked after `tls` is gone (e.g. static pools) */
+		static inline thread_local cache_state tls_state = cache_state::unused;
+
+		static shared_core* make_core(size_t batch) {
+			void *mem = std::aligned_alloc(alignof(shared_core), sizeof(shared_core));
+			if (!mem) std::abort();
+			shared_core *c = new (mem) shared_core;
+			c->free_head = 0;
+			c->chunks = nullptr;
+			c->batch_size = batch;
+			c->refs = 1;
+			c->alive = true;
+			return c;
+		}
+		static void release_core(shared_core *c) noexcept {
+			if (__atomic_sub_fetch(&c->refs, 1, __ATOMIC_ACQ_REL)) return;
+			for (chunk *ch = c->chunks; ch; ) {
+				chunk *next = ch->next;
+				if constexpr (resettable) {
+					for (size_t i = 0; i < ch->count; i++) { reinterpret_cast<T*>(ch->nodes()[i].storage)->~T(); }
+				}
+				std::free(ch);
+				ch = next;
+			}
+			std::free(c);
+		}
+
+		/* Slow paths are kept out of line so that acquire()/release() stay a handful of instructions */
+		cache_entry& local_entry() noexcept {
+			thread_cache &t = tls;
+			cache_entry &hit = t.entries[t.last];
+			if (hit.core == core) [[likely]] return hit;
+			return find_entry(t);
+		}
+		/* The entries keep their cores alive, so comparing and reading them is always safe */
+		[[gnu::noinline]] cache_entry& find_entry(thread_cache &t) noexcept {
+			tls_state = cache_state::live;
+			cache_entry *free = nullptr;
+			for (size_t i = 0; i < thread_cache::size; i++) {
+				cache_entry &e = t.entries[i];
+				if (e.core == core) {
+					t.last = i;
+					return e;
+				}
+				if (e.core && !__atomic_load_n(&e.core->alive, __ATOMIC_ACQUIRE)) drop(e);
+				if (!e.core && !free) free = &e;
+			}
+			if (!free) {
+				/* More live pools of this type than entries, hand one cache back to its pool */
+				free = &t.entries[t.victim];
+				t.victim = (t.victim + 1) % thread_cache::size;
+				drop(*free);
+			}
+			__atomic_add_fetch(&core->refs, 1, __ATOMIC_RELAXED);
+			free->core = core;
+			t.last = static_cast<size_t>(free - t.entries);
+			return *free;
+		}
+		/* Returns the cached nodes to a live pool and lets go of the core */
+		static void drop(cache_entry &e) noexcept {
+			if (__atomic_load_n(&e.core->alive, __ATOMIC_ACQUIRE)) {
+				while (e.head) { push_batch(e.core, cut_front(e.head, e.core->batch_size)); }
+			}
+			release_core(e.core);
+			e = cache_entry{};
+		}
+
+		/* Splits up to `max` nodes off the front of `list` as one counted chain */
+		static node* cut_front(node *&list, size_t max) noexcept {
+			node *first = list;
+			node *last = first;
+			size_t n = 1;
+			for (; n < max && last->link.next; n++) { last = last->link.next; }
+			list = last->link.next;
+			last->link.next = nullptr;
+			first->link.count = n;
+			return first;
+		}
+		/* The front of the LIFO list was freed most recently and is still cache hot, so the thread keeps
+		   one batch from the front and gives the older tail away */
+		[[gnu::noinline]] void give_back_tail(cache_entry &c) noexcept {
+			node *keep_last = c.head;
+			for (size_t i = 1; i < core->batch_size; i++) { keep_last = keep_last->link.next; }
+			node *tail = keep_last->link.next;
+			keep_last->link.next = nullptr;
+			tail->link.count = c.count - core->batch_size;
+			c.count = core->batch_size;
+			push_batch(core, tail);
+		}
+
+		static constexpr uint64_t ptr_mask = (1ull << 48) - 1;
+		/* Sign-extends bit 47 back, so upper half addresses stay canonical */
+		static node* untag(uint64_t value) noexcept { return reinterpret_cast<node*>(static_cast<int64_t>(value << 16) >> 16); }
+		static uint64_t retag(node *n, uint64_t old) noexcept 
+		{ return (reinterpret_cast<uint64_t>(n) & ptr_mask) | ((old & ~ptr_mask) + (1ull << 48)); }
+
+		static void push_batch(shared_core *c, node *batch) noexcept {
+			if (untag(reinterpret_cast<uint64_t>(batch)) != batch) std::abort();
+			uint64_t old = __atomic_load_n(&c->free_head, __ATOMIC_RELAXED);
+			do {
+				__atomic_store_n(&batch->next_batch, untag(old), __ATOMIC_RELAXED);
+			} while (!__atomic_compare_exchange_n(&c->free_head, &old, retag(batch, old), true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+		}
+		static node* pop_batch(shared_core *c) noexcept {
+			uint64_t old = __atomic_load_n(&c->free_head, __ATOMIC_ACQUIRE);
+			for (;;) {
+				node *top = untag(old);
+				if (!top) return nullptr;
+				/* `top` may already be popped and pushed again by others, the tag makes the CAS fail then */
+				node *next = __atomic_load_n(&top->next_batch, __ATOMIC_RELAXED);
+				if (__atomic_compare_exchange_n(&c->free_head, &old, retag(next, old), true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+					return top;
+			}
+		}
+
+		[[gnu::noinline]] node* refill(cache_entry &c) {
+			if (node *batch = pop_batch(core)) {
+				c.head = batch;
+				c.count = batch->link.count;
+				return batch;
+			}
+			/* Nothing to recycle, carve a new chunk */
+			const size_t batch_size = core->batch_size;
+			void *mem = std::aligned_alloc(node_align, (nodes_offset + batch_size * sizeof(node) + node_align - 1) & ~(node_align - 1));
+			if (!mem) std::abort();
+			chunk *ch = static_cast<chunk*>(mem);
+			ch->count = batch_size;
+			node *nodes = ch->nodes();
+			for (size_t i = 0; i < batch_size; i++) {
+				if constexpr (resettable) new (nodes[i].storage) T();
+				nodes[i].next_batch = nullptr;
+				nodes[i].link.next = (i + 1 < batch_size) ? &nodes[i + 1] : nullptr;
+			}
+			ch->next = __atomic_load_n(&core->chunks, __ATOMIC_RELAXED);
+			while (!__atomic_compare_exchange_n(&core->chunks, &ch->next, ch, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+			c.head = nodes;
+			c.count = batch_size;
+			return nodes;
+		}
+	private:
+		shared_core *core;
+	};
+}
+
+#endif /* ZL_OBJECT_POOL_HPP */
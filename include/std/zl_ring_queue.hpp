@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2022, suncloudsmoon and the tree-cpp contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZL_RING_QUEUE_HPP
+#define ZL_RING_QUEUE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <new>
+#include <utility>
+
+/* <atomic> isn't provided, the rings use the GCC/Clang __atomic builtins directly */
+#ifndef __GNUC__
+#error "zl::spsc_ring and zl::mpmc_ring need the __atomic builtins of GCC/Clang!"
+#endif
+
+namespace zl {
+	/* Indices written by different threads are kept this far apart to avoid false sharing */
+	inline constexpr size_t cache_line_size = 64;
+
+	/* Bounded single-producer/single-consumer queue. Each side keeps a cached copy of the other
+	   side's index and only reloads it when the ring looks full (or empty). */
+	template<typename T, size_t N>
+	class spsc_ring {
+		static_assert(N && !(N & (N - 1)), "[zl::spsc_ring<T, N> error] -> N must be a power of two!");
+	public:
+		using value_type = T;
+		using size_type = size_t;
+	public:
+		spsc_ring() noexcept : tail(0), head_cache(0), head(0), tail_cache(0) {}
+		spsc_ring(const spsc_ring&) = delete;
+		spsc_ring& operator=(const spsc_ring&) = delete;
+		~spsc_ring() {
+			for (size_t i = head; i != tail; i++) { slot(i)->~T(); }
+		}
+
+		static constexpr size_type capacity() noexcept { return N; }
+		/* Only exact when neither side is running */
+		size_type size_approx() const noexcept 
+		{ return __atomic_load_n(&tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&head, __ATOMIC_ACQUIRE); }
+
+		// Producer side
+		template<typename... Args>
+		bool try_emplace(Args&&... args) {
+			const size_t t = tail;
+			if (t - head_cache == N) {
+				head_cache = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+				if (t - head_cache == N) return false;
+			}
+			new (slot(t)) T(std::forward<Args>(args)...);
+			__atomic_store_n(&tail, t + 1, __ATOMIC_RELEASE);
+			return true;
+		}
+		bool try_push(const T &value) { return try_emplace(value); }
+		bool try_push(T &&value) { return try_emplace(std::move(value)); }
+		/* Moves up to `count` elements in and publishes them at once, returns how many fit */
+		size_type push_batch(T *src, size_type count) {
+			const size_t t = tail;
+			size_t free = N - (t - head_cache);
+			if (free < count) {
+				head_cache = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+				free = N - (t - head_cache);
+			}
+			if (count > free) count = free;
+			for (size_t i = 0; i < count; i++) { new (slot(t + i)) T(std::move(src[i])); }
+			__atomic_store_n(&tail, t + count, __ATOMIC_RELEASE);
+			return count;
+		}
+
+		// Consumer side
+		bool try_pop(T &out) {
+			const size_t h = head;
+			if (h == tail_cache) {
+				tail_cache = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+				if (h == tail_cache) return false;
+			}
+			T *elem = slot(h);
+			out = std::move(*elem);
+			elem->~T();
+			__atomic_store_n(&head, h + 1, __ATOMIC_RELEASE);
+			return true;
+		}
+		/* Moves up to `count` elements out into `dest`, returns how many were available */
+		size_type pop_batch(T *dest, size_type count) {
+			const size_t h = head;
+			size_t avail = tail_cache - h;
+			if (avail < count) {
+				tail_cache = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+				avail = tail_cache - h;
+			}
+			if (count > avail) count = avail;
+			for (size_t i = 0; i < count; i++) {
+				T *elem = slot(h + i);
+				dest[i] = std::move(*elem);
+				elem->~T();
+			}
+			__atomic_store_n(&head, h + count, __ATOMIC_RELEASE);
+			return count;
+		}
+	private:
+		T* slot(size_t index) noexcept { return reinterpret_cast<T*>(storage) + (index & (N - 1)); }
+	private:
+		/* Producer-owned line */
+		alignas(cache_line_size) size_t tail;
+		size_t head_cache;
+		/* Consumer-owned line */
+		alignas(cache_line_size) size_t head;
+		size_t tail_cache;
+		alignas(cache_line_size) alignas(T) unsigned char storage[N * sizeof(T)];
+	};
+
+	/* Bounded multi-producer/multi-consumer queue (Vyukov's design). Every cell carries a sequence
+	   number telling whether it is ready to be written or read for the current lap, so producers and
+	   consumers only contend on their own position counter. */
+	template<typename T, size_t N>
+	class mpmc_ring {
+		static_assert(N >= 2 && !(N & (N - 1)), "[zl::mpmc_ring<T, N> error] -> N must be a power of two (at least 2)!");
+	public:
+		using value_type = T;
+		using size_type = size_t;
+	public:
+		mpmc_ring() noexcept : enqueue_pos(0), dequeue_pos(0) {
+			for (size_t i = 0; i < N; i++) { cells[i].seq = i; }
+		}
+		mpmc_ring(const mpmc_ring&) = delete;
+		mpmc_ring& operator=(const mpmc_ring&) = delete;
+		~mpmc_ring() {
+			for (size_t i = dequeue_pos; i != enqueue_pos; i++) { cells[i & (N - 1)].elem()->~T(); }
+		}
+
+		static constexpr size_type capacity() noexcept { return N; }
+		/* Only exact when no thread is running */
+		size_type size_approx() const noexcept {
+			return __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED) - __atomic_load_n(&dequeue_pos, __ATOMIC_RELAXED);
+		}
+
+		template<typename... Args>
+		bool try_emplace(Args&&... args) {
+			size_t pos;
+			cell *c = claim<0>(enqueue_pos, pos);
+			if (!c) return false;
+			new (c->elem()) T(std::forward<Args>(args)...);
+			__atomic_store_n(&c->seq, pos + 1, __ATOMIC_RELEASE);
+			return true;
+		}
+		bool try_push(const T &value) { return try_emplace(value); }
+		bool try_push(T &&value) { return try_emplace(std::move(value)); }
+		bool try_pop(T &out) {
+			size_t pos;
+			cell *c = claim<1>(dequeue_pos, pos);
+			if (!c) return false;
+			out = std::move(*c->elem());
+			c->elem()->~T();
+			__atomic_store_n(&c->seq, pos + N, __ATOMIC_RELEASE);
+			return true;
+		}
+
+		/* Claims a run of consecutive cells with a single CAS, returns how many were moved in */
+		size_type push_batch(T *src, size_type count) {
+			size_t pos;
+			count = claim_run<0>(enqueue_pos, pos, count);
+			for (size_t i = 0; i < count; i++) {
+				cell &c = cells[(pos + i) & (N - 1)];
+				new (c.elem()) T(std::move(src[i]));
+				__atomic_store_n(&c.seq, pos + i + 1, __ATOMIC_RELEASE);
+			}
+			return count;
+		}
+		size_type pop_batch(T *dest, size_type count) {
+			size_t pos;
+			count = claim_run<1>(dequeue_pos, pos, count);
+			for (size_t i = 0; i < count; i++) {
+				cell &c = cells[(pos + i) & (N - 1)];
+				dest[i] = std::move(*c.elem());
+				c.elem()->~T();
+				__atomic_store_n(&c.seq, pos + i + N, __ATOMIC_RELEASE);
+			}
+			return count;
+		}
+	private:
+		struct cell {
+			T* elem() noexcept { return reinterpret_cast<T*>(storage); }
+
+			size_t seq;
+			alignas(T) unsigned char storage[sizeof(T)];
+		};
+
+		/* A cell at position `pos` is writable when seq == pos and readable when seq == pos + 1,
+		   `Lag` selects which of the two is being waited for */
+		template<size_t Lag>
+		cell* claim(size_t &counter, size_t &pos) noexcept {
+			pos = __atomic_load_n(&counter, __ATOMIC_RELAXED);
+			for (;;) {
+				cell *c = &cells[pos & (N - 1)];
+				const intptr_t diff = static_cast<intptr_t>(__atomic_load_n(&c->seq, __ATOMIC_ACQUIRE) - (pos + Lag));
+				if (diff == 0) {
+					if (__atomic_compare_exchange_n(&counter, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+						return c;
+				} else if (diff < 0) {
+					return nullptr;
+				} else {
+					pos = __atomic_load_n(&counter, __ATOMIC_RELAXED);
+				}
+			}
+		}
+		template<size_t Lag>
+		size_t claim_run(size_t &counter, size_t &pos, size_t count) noexcept {
+			if (count > N) count = N;
+			pos = __atomic_load_n(&counter, __ATOMIC_RELAXED);
+			for (;;) {
+				/* Cells that are ready stay ready until someone moves the counter past them */
+				size_t ready = 0;
+				for (; ready < count; ready++) {
+					const size_t p = pos + ready;
+					if (__atomic_load_n(&cells[p & (N - 1)].seq, __ATOMIC_ACQUIRE) != p + Lag) break;
+				}
+				if (!ready) {
+					const intptr_t diff = static_cast<intptr_t>(__atomic_load_n(&cells[pos & (N - 1)].seq, __ATOMIC_ACQUIRE) - (pos + Lag));
+					if (diff < 0) return 0;
+					pos = __atomic_load_n(&counter, __ATOMIC_RELAXED);
+					continue;
+				}
+				if (__atomic_compare_exchange_n(&counter, &pos, pos + ready, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+					return ready;
+			}
+		}
+	private:
+		alignas(cache_line_size) size_t enqueue_pos;
+		alignas(cache_line_size) size_t dequeue_pos;
+		alignas(cache_line_size) cell cells[N];
+	};
+}
+
+#endif /* ZL_RING_QUEUE_HPP */
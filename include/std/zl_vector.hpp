@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2022, suncloudsmoon and the tree-cpp contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZL_VECTOR_HPP
+#define ZL_VECTOR_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+#include "zl_allocator.hpp"
+
+namespace zl {
+	/* Growable array. Trivially relocatable elements are moved with memcpy(), and grown through
+	   Alloc::reallocate() (when the allocator has one) so the heap can extend the block in place. */
+	template<typename T, typename Alloc = allocator<T>>
+	class vector {
+	public:
+		using value_type = T;
+		using allocator_type = Alloc;
+		using size_type = size_t;
+		using reference = T&;
+		using const_reference = const T&;
+		using pointer = T*;
+		using const_pointer = const T*;
+		using iterator = T*;
+		using const_iterator = const T*;
+	public:
+		vector() noexcept : first(nullptr), last(nullptr), cap_end(nullptr), alloc() {}
+		explicit vector(const Alloc &a) noexcept : first(nullptr), last(nullptr), cap_end(nullptr), alloc(a) {}
+		explicit vector(size_type n, const Alloc &a = Alloc()) : vector(a) { resize(n); }
+		vector(size_type n, const T &value, const Alloc &a = Alloc()) : vector(a) { resize(n, value); }
+		vector(const vector &other) : vector(other.alloc) { append(other.data(), other.size()); }
+		vector(vector &&other) noexcept 
+			: first(other.first), last(other.last), cap_end(other.cap_end), alloc(std::move(other.alloc)) {
+			other.first = other.last = other.cap_end = nullptr;
+		}
+		~vector() { release(); }
+		vector& operator=(const vector &other) {
+			if (this != &other) {
+				vector temp(other);
+				swap(temp);
+			}
+			return *this;
+		}
+		vector& operator=(vector &&other) noexcept {
+			if (this != &other) {
+				release();
+				first = other.first;
+				last = other.last;
+				cap_end = other.cap_end;
+				alloc = std::move(other.alloc);
+				other.first = other.last = other.cap_end = nullptr;
+			}
+			return *this;
+		}
+
+		// Element access
+		reference operator[](size_type index) noexcept { return first[index]; }
+		const_reference operator[](size_type index) const noexcept { return first[index]; }
+		reference front() noexcept { return *first; }
+		const_reference front() const noexcept { return *first; }
+		reference back() noexcept { return *(last - 1); }
+		const_reference back() const noexcept { return *(last - 1); }
+		pointer data() noexcept { return first; }
+		const_pointer data() const noexcept { return first; }
+
+		// Iterators
+		iterator begin() noexcept { return first; }
+		const_iterator begin() const noexcept { return first; }
+		const_iterator cbegin() const noexcept { return first; }
+		iterator end() noexcept { return last; }
+		const_iterator end() const noexcept { return last; }
+		const_iterator cend() const noexcept { return last; }
+
+		// Capacity
+		bool empty() const noexcept { return first == last; }
+		size_type size() const noexcept { return static_cast<size_type>(last - first); }
+		size_type capacity() const noexcept { return static_cast<size_type>(cap_end - first); }
+		allocator_type get_allocator() const noexcept { return alloc; }
+		void reserve(size_type n) { if (n > capacity()) reallocate_storage(n); }
+		void shrink_to_fit() {
+			if (last == cap_end) return;
+			if (empty()) release();
+			else reallocate_storage(size());
+		}
+
+		// Modifiers
+		void clear() noexcept {
+			destroy_range(first, last);
+			last = first;
+		}
+		template<typename... Args>
+		reference emplace_back(Args&&... args) {
+			if (last == cap_end) return emplace_back_slow(std::forward<Args>(args)...);
+			new (last) T(std::forward<Args>(args)...);
+			return *last++;
+		}
+		void push_back(const T &value) { emplace_back(value); }
+		void push_back(T &&value) { emplace_back(std::move(value)); }
+		void pop_back() noexcept {
+			--last;
+			last->~T();
+		}
+		/* New elements are value-initialized (zeroed for trivial types) */
+		void resize(size_type n) {
+			if (n <= size()) return truncate(n);
+			grow_to(n);
+			for (; last != first + n; ++last) { new (last) T(); }
+		}
+		void resize(size_type n, const T &value) {
+			if (n <= size()) return truncate(n);
+			if (n > capacity()) {
+				/* `value` may live in this vector */
+				T copy(value);
+				grow_to(n);
+				for (; last != first + n; ++last) { new (last) T(copy); }
+				return;
+			}
+			for (; last != first + n; ++last) { new (last) T(value); }
+		}
+		/* Like resize(), but new elements are default-initialized: trivial types are left
+		   uninitialized, for buffers that are about to be overwritten anyway */
+		void resize_default_init(size_type n) {
+			if (n <= size()) return truncate(n);
+			grow_to(n);
+			for (; last != first + n; ++last) { new (last) T; }
+		}
+		/* Copies `count` elements to the end (a single memcpy() for trivially copyable types) */
+		void append(const T *src, size_type count) {
+			if (!count) return;
+			if (size() + count > capacity()) {
+				/* `src` may point into this vector */
+				const uintptr_t addr = reinterpret_cast<uintptr_t>(src);
+				const bool inside = (addr >= reinterpret_cast<uintptr_t>(first)) && (addr < reinterpret_cast<uintptr_t>(last));
+				const size_type offset = inside ? static_cast<size_type>(src - first) : 0;
+				reallocate_storage(grow_capacity(size() + count));
+				if (inside) src = first + offset;
+			}
+			if constexpr (__is_trivially_copyable(T)) {
+				__builtin_memcpy(static_cast<void*>(last), src, count * sizeof(T));
+				last += count;
+			} else {
+				for (size_type i = 0; i < count; i++, ++last) { new (last) T(src[i]); }
+			}
+		}
+		iterator erase(const_iterator pos) { return erase(pos, pos + 1); }
+		iterator erase(const_iterator from, const_iterator to) {
+			T *dest = first + (from - first);
+			T *src = first + (to - first);
+			if (dest == src) return dest;
+			if constexpr (is_trivially_relocatable<T>) {
+				destroy_range(dest, src);
+				__builtin_memmove(static_cast<void*>(dest), src, static_cast<size_t>(last - src) * sizeof(T));
+				last -= (src - dest);
+			} else {
+				T *out = dest;
+				for (; src != last; ++src, ++out) { *out = std::move(*src); }
+				destroy_range(out, last);
+				last = out;
+			}
+			return dest;
+		}
+		void swap(vector &other) noexcept {
+			vector temp(std::move(other));
+			other = std::move(*this);
+			*this = std::move(temp);
+		}
+	private:
+		static constexpr bool can_reallocate = requires(Alloc &a, T *ptr, size_type n) { a.reallocate(ptr, n, n); };
+
+		static void destroy_range(T *from, T *to) noexcept {
+			if constexpr (!is_trivially_destructible<T>) {
+				for (; from != to; ++from) { from->~T(); }
+			}
+		}
+		/* Moves [from, to) into uninitialized storage at `dest`, ending the lifetime of the sources */
+		static void relocate(T *from, T *to, T *dest) noexcept {
+			if constexpr (is_trivially_relocatable<T>) {
+				if (from != to) __builtin_memcpy(static_cast<void*>(dest), from, static_cast<size_t>(to - from) * sizeof(T));
+			} else {
+				for (; from != to; ++from, ++dest) {
+					new (dest) T(std::move(*from));
+					from->~T();
+				}
+			}
+		}
+
+		void truncate(size_type n) noexcept {
+			destroy_range(first + n, last);
+			last = first + n;
+		}
+		void release() noexcept {
+			destroy_range(first, last);
+			if (first) alloc.deallocate(first, capacity());
+			first = last = cap_end = nullptr;
+		}
+		/* Doubles, but always fits `needed` and starts at roughly a cache line of elements */
+		size_type grow_capacity(size_type needed) const noexcept {
+			constexpr size_type min_cap = (sizeof(T) < 64) ? (64 / sizeof(T)) : 1;
+			size_type new_cap = capacity() * 2;
+			if (new_cap < needed) new_cap = needed;
+			return (new_cap < min_cap) ? min_cap : new_cap;
+		}
+		/* Growth for the resize paths: geometric, so stepping the size up stays amortized O(1)
+		   (reserve() on the other hand allocates exactly what was asked for) */
+		void grow_to(size_type n) { if (n > capacity()) reallocate_storage(grow_capacity(n)); }
+		void reallocate_storage(size_type new_cap) {
+			const size_type n = size();
+			T *mem;
+			if constexpr (is_trivially_relocatable<T> && can_reallocate) {
+				mem = alloc.reallocate(first, capacity(), new_cap);
+				if (!mem) std::abort();
+			} else {
+				mem = alloc.allocate(new_cap);
+				if (!mem) std::abort();
+				relocate(first, last, mem);
+				if (first) alloc.deallocate(first, capacity());
+			}
+			first = mem;
+			last = mem + n;
+			cap_end = mem + new_cap;
+		}
+		template<typename... Args>
+		reference emplace_back_slow(Args&&... args) {
+			/* The arguments may refer to elements of this vector, so the new element is built
+			   before the old storage goes away */
+			if constexpr (is_trivially_relocatable<T> && can_reallocate) {
+				alignas(T) unsigned char temp[sizeof(T)];
+				new (temp) T(std::forward<Args>(args)...);
+				reallocate_storage(grow_capacity(size() + 1));
+				__builtin_memcpy(static_cast<void*>(last), temp, sizeof(T));
+			} else {
+				const size_type n = size();
+				const size_type new_cap = grow_capacity(n + 1);
+				T *mem = alloc.allocate(new_cap);
+				if (!mem) std::abort();
+				new (mem + n) T(std::forward<Args>(args)...);
+				relocate(first, last, mem);
+				if (first) alloc.deallocate(first, capacity());
+				first = mem;
+				last = mem + n;
+				cap_end = mem + new_cap;
+			}
+			return *last++;
+		}
+	private:
+		T *first;
+		T *last;
+		T *cap_end;
+		[[no_unique_address]] allocator_type alloc;
+	};
+
+	template<typename T, typename Alloc>
+	inline void swap(vector<T, Alloc> &f, vector<T, Alloc> &s) noexcept {
+		f.swap(s);
+	}
+}
+
+#endif /* ZL_VECTOR_HPP */
@@ -19,13 +19,101 @@
 
 #include "../include/std/memory"
 #include "../include/std/cmath"
+#include "../include/std/cstring"
 
 #include <stdio.h>
 
 #include "../include/std/x86_instr.hpp"
+#include "../include/std/zl_flat_hash_map.hpp"
+#include "../include/std/zl_vector.hpp"
+#include "../include/std/zl_object_pool.hpp"
+
+/* Long keys (>= 256 bytes) take the SIMD lane accumulator at run time, but the scalar path
+   during constant evaluation */
+struct hash_test_key {
+	char bytes[2100];
+};
+constexpr hash_test_key make_hash_test_key() {
+	hash_test_key key{};
+	for (size_t i = 0; i < sizeof(key.bytes); i++) { key.bytes[i] = static_cast<char>(i * 131 + 7); }
+	return key;
+}
+constexpr hash_test_key hash_key = make_hash_test_key();
+
+/* Fixed-size name key, looked up by plain C strings through a transparent hasher */
+struct name_key {
+	explicit name_key(const char *str) : len(__builtin_strlen(str)) { __builtin_memcpy(text, str, len + 1); }
+	bool operator==(const name_key &other) const { return len == other.len && __builtin_memcmp(text, other.text, len) == 0; }
+	bool operator==(const char *str) const { return __builtin_strcmp(text, str) == 0; }
+
+	char text[16];
+	size_t len;
+};
+struct name_hash {
+	using is_transparent = void;
+	size_t operator()(const name_key &key) const { return zl::hash_bytes(static_cast<const void*>(key.text), key.len); }
+	size_t operator()(const char *str) const { return zl::hash_bytes(static_cast<const void*>(str), __builtin_strlen(str)); }
+};
 
 /* Using C-style printing functions to avoid conflicts with the C++'s std namespace */
 int main() {
 	printf("fmod() of 1000 %% 3: %f\n", std::fmod(2, 3));
 	printf("zl::math_instr::scale(): %f\n", zl::math_instr::scale(10.f, 10.f));
+	printf("zl::hash_bytes() of \"tree-cpp\": %llx\n", static_cast<unsigned long long>(zl::hash_bytes("tree-cpp", 8)));
+	static_assert(zl::eval_hash("tree-cpp") == zl::hash_bytes("tree-cpp", 8), "zl::eval_hash() must fold to the run-time hash");
+	constexpr size_t long_lens[] = { 256, 1024, 1025, 2100 };
+	constexpr uint64_t long_hashes[] = { 
+		zl::hash_bytes(hash_key.bytes, 256), zl::hash_bytes(hash_key.bytes, 1024), 
+		zl::hash_bytes(hash_key.bytes, 1025), zl::hash_bytes(hash_key.bytes, 2100) 
+	};
+	bool hash_ok = true;
+	for (size_t i = 0; i < 4; i++) 
+	{ hash_ok &= (zl::hash_bytes(static_cast<const void*>(hash_key.bytes), long_lens[i]) == long_hashes[i]); }
+	printf("zl::hash_bytes() of long keys matches compile time: %s\n", hash_ok ? "yes" : "NO");
+	if (!hash_ok) return 1;
+
+	zl::flat_hash_map<int, std::unique_ptr<int>> table;
+	for (int i = 0; i < 1000; i++) { table.try_emplace(i, new int{ i * i }); }
+	for (int i = 0; i < 1000; i += 2) { table.erase(i); }
+	printf("zl::flat_hash_map<>::size() after erasing evens: %zu, table[31] = %d\n", table.size(), *table[31].get());
+
+	/* 100 names fill 128 slots past 3/4, so erased slots mostly turn into tombstones */
+	zl::flat_hash_map<name_key, int, name_hash, zl::equal_to<>> names;
+	char name[16];
+	for (int i = 0; i < 100; i++) {
+		snprintf(name, sizeof(name), "name-%d", i);
+		names.try_emplace(name_key(name), i);
+	}
+	bool lookup_ok = !names.contains("name-100") && names.find("missing") == names.end() && names.erase("missing") == 0;
+	for (int round = 1; round <= 20; round++) {
+		for (int i = 0; i < 100; i += 2) {
+			snprintf(name, sizeof(name), "name-%d", i);
+			lookup_ok &= (names.erase(name) == 1) && !names.contains(name);
+		}
+		for (int i = 0; i < 100; i += 2) {
+			snprintf(name, sizeof(name), "name-%d", i);
+			lookup_ok &= names.try_emplace(name_key(name), i + round * 1000).inserted;
+		}
+	}
+	for (int i = 0; i < 100; i++) {
+		snprintf(name, sizeof(name), "name-%d", i);
+		auto it = names.find(name);
+		lookup_ok &= (it != names.end()) && (it->second == ((i % 2) ? i : i + 20000)) && (names.count(name) == 1);
+	}
+	lookup_ok &= (names.size() == 100);
+	printf("zl::flat_hash_map<> heterogeneous lookup through tombstones: %s\n", lookup_ok ? "ok" : "BROKEN");
+	if (!lookup_ok) return 1;
+
+	zl::vector<double> samples;
+	for (int i = 0; i < 1000; i++) { samples.emplace_back(i * 0.5); }
+	samples.append(samples.data(), samples.size());
+	printf("zl::vector<>::size(): %zu, back(): %f\n", samples.size(), samples.back());
+
+	zl::object_pool<double> pool;
+	double *first = nullptr;
+	for (int i = 0; i < 3; i++) {
+		auto obj = pool.make(i * 1.5);
+		if (!first) first = obj.get();
+		printf("zl::object_pool<>::make(): %f (recycled: %s)\n", *obj.get(), (obj.get() == first) ? "yes" : "no");
+	}
 }
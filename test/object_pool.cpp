@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2022, suncloudsmoon and the tree-cpp contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "../include/std/zl_object_pool.hpp"
+#include "../include/std/zl_ring_queue.hpp"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+/* Multi-threaded stress test + throughput benchmark of zl::object_pool.
+   Build: make bin/object_pool */
+
+static constexpr int threads = 4;
+static constexpr int rounds = 2'000'000;
+static constexpr int held_per_thread = 64;
+
+static double now_sec() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+static void spin() {
+	__builtin_ia32_pause();
+	sched_yield();
+}
+static uint64_t next_rand(uint64_t &state) {
+	state = state * 6364136223846793005ull + 1442695040888963407ull;
+	return state >> 33;
+}
+
+/* Objects survive in the pool, so a claim flag catches an object being handed out twice */
+struct descriptor {
+	uint32_t claimed;
+	uint64_t tag;
+};
+template<> inline constexpr bool zl::is_trivially_resettable<descriptor> = true;
+
+/* Constructed on every acquire, a double hand-out shows up as an overwritten tag */
+struct request {
+	explicit request(uint64_t t) : tag(t) {}
+	uint64_t tag;
+	char payload[48];
+};
+
+static zl::object_pool<descriptor> desc_pool(32);
+static zl::object_pool<request> req_pool(32);
+/* Objects handed to other threads, so that they get released far from where they were acquired */
+static zl::mpmc_ring<descriptor*, 1024> desc_handoff;
+static zl::mpmc_ring<request*, 1024> req_handoff;
+
+struct worker_args {
+	int id;
+	bool ok;
+};
+
+static descriptor* claim_descriptor(uint64_t tag, bool &ok) {
+	descriptor *d = desc_pool.acquire();
+	ok &= (__atomic_exchange_n(&d->claimed, 1u, __ATOMIC_ACQ_REL) == 0);
+	d->tag = tag;
+	return d;
+}
+static void return_descriptor(descriptor *d, bool &ok) {
+	ok &= (__atomic_exchange_n(&d->claimed, 0u, __ATOMIC_ACQ_REL) == 1);
+	desc_pool.release(d);
+}
+
+static void* stress_worker(void *arg) {
+	auto *args = static_cast<worker_args*>(arg);
+	uint64_t rng = static_cast<uint64_t>(args->id) + 1;
+	descriptor *descs[held_per_thread] = {};
+	request *reqs[held_per_thread] = {};
+	uint64_t desc_tags[held_per_thread] = {};
+	uint64_t req_tags[held_per_thread] = {};
+	args->ok = true;
+	for (int i = 0; i < rounds; i++) {
+		const uint64_t r = next_rand(rng);
+		const int slot = static_cast<int>(r % held_per_thread);
+		const uint64_t tag = (static_cast<uint64_t>(args->id) << 40) | static_cast<uint64_t>(i);
+		switch ((r >> 8) % 4) {
+			case 0:
+				if (descs[slot]) {
+					args->ok &= (descs[slot]->tag == desc_tags[slot]);
+					return_descriptor(descs[slot], args->ok);
+					descs[slot] = nullptr;
+				} else {
+					descs[slot] = claim_descriptor(tag, args->ok);
+					desc_tags[slot] = tag;
+				}
+				break;
+			case 1:
+				if (reqs[slot]) {
+					args->ok &= (reqs[slot]->tag == req_tags[slot]);
+					req_pool.release(reqs[slot]);
+					reqs[slot] = nullptr;
+				} else {
+					reqs[slot] = req_pool.acquire(tag);
+					req_tags[slot] = tag;
+				}
+				break;
+			case 2: {
+				/* Pass an object to whichever thread pops it */
+				descriptor *d = claim_descriptor(tag, args->ok);
+				if (!desc_handoff.try_push(d)) return_descriptor(d, args->ok);
+				request *q = req_pool.acquire(tag);
+				if (!req_handoff.try_push(q)) req_pool.release(q);
+				break;
+			}
+			default: {
+				descriptor *d;
+				if (desc_handoff.try_pop(d)) return_descriptor(d, args->ok);
+				request *q;
+				if (req_handoff.try_pop(q)) req_pool.release(q);
+				break;
+			}
+		}
+	}
+	for (int i = 0; i < held_per_thread; i++) {
+		if (descs[i]) return_descriptor(descs[i], args->ok);
+		if (reqs[i]) req_pool.release(reqs[i]);
+	}
+	return nullptr;
+}
+
+static bool run_stress() {
+	worker_args args[threads];
+	pthread_t th[threads];
+	const double start = now_sec();
+	for (int i = 0; i < threads; i++) {
+		args[i] = { i, false };
+		pthread_create(&th[i], nullptr, stress_worker, &args[i]);
+	}
+	bool ok = true;
+	for (int i = 0; i < threads; i++) {
+		pthread_join(th[i], nullptr);
+		ok &= args[i].ok;
+	}
+	const double secs = now_sec() - start;
+	/* Drain what the threads left in flight */
+	descriptor *d;
+	while (desc_handoff.try_pop(d)) { return_descriptor(d, ok); }
+	request *q;
+	while (req_handoff.try_pop(q)) { req_pool.release(q); }
+	printf("zl::object_pool stress (%d threads): %6.1f M ops/s, unique hand-out %s\n", threads, 
+			threads * static_cast<double>(rounds) / secs / 1e6, ok ? "ok" : "BROKEN");
+	return ok;
+}
+
+/* A thread keeps its cache for a pool that another thread destroys, then keeps using other pools
+   of the same type and finally exits */
+static zl::object_pool<request> *doomed_pool;
+static int doomed_stage;
+
+static void wait_stage(int stage) {
+	while (__atomic_load_n(&doomed_stage, __ATOMIC_ACQUIRE) != stage) { spin(); }
+}
+static void* doomed_worker(void*) {
+	request *objs[100];
+	for (auto &obj : objs) { obj = doomed_pool->acquire(uint64_t{ 1 }); }
+	for (int i = 0; i < 50; i++) { doomed_pool->release(objs[i]); }
+	/* The other half goes back from the main thread */
+	__atomic_store_n(&doomed_stage, 1, __ATOMIC_RELEASE);
+	wait_stage(2);
+
+	zl::object_pool<request> other(16);
+	for (int i = 0; i < 1000; i++) { other.release(other.acquire(uint64_t{ 2 })); }
+	request *kept = req_pool.acquire(uint64_t{ 3 });
+	req_pool.release(kept);
+	return nullptr;
+}
+static bool run_pool_destroyed_first() {
+	doomed_pool = new zl::object_pool<request>(16);
+	pthread_t th;
+	pthread_create(&th, nullptr, doomed_worker, nullptr);
+	wait_stage(1);
+	request *rest[50];
+	for (auto &obj : rest) { obj = doomed_pool->acquire(uint64_t{ 4 }); }
+	for (auto *obj : rest) { doomed_pool->release(obj); }
+	delete doomed_pool;
+	doomed_pool = nullptr;
+	__atomic_store_n(&doomed_stage, 2, __ATOMIC_RELEASE);
+	pthread_join(th, nullptr);
+	printf("zl::object_pool destroyed before a thread using it: ok\n");
+	return true;
+}
+
+static bool run_benchmark() {
+	zl::object_pool<request> a, b;
+	constexpr int iterations = 20'000'000;
+	uint64_t sum = 0;
+	double start = now_sec();
+	for (int i = 0; i < iterations; i++) {
+		request *r = a.acquire(static_cast<uint64_t>(i));
+		sum += r->tag;
+		a.release(r);
+	}
+	const double single = (now_sec() - start) / iterations * 1e9;
+	/* Two pools of one type used in turns must not evict each other's caches */
+	start = now_sec();
+	for (int i = 0; i < iterations; i++) {
+		zl::object_pool<request> &p = (i & 1) ? a : b;
+		request *r = p.acquire(static_cast<uint64_t>(i));
+		sum += r->tag;
+		p.release(r);
+	}
+	const double alternating = (now_sec() - start) / iterations * 1e9;
+	printf("zl::object_pool acquire+release: %.1f ns, alternating pools: %.1f ns (%llu)\n", 
+			single, alternating, static_cast<unsigned long long>(sum & 1));
+	return true;
+}
+
+int main() {
+	bool ok = true;
+	ok &= run_stress();
+	ok &= run_pool_destroyed_first();
+	ok &= run_benchmark();
+	return ok ? 0 : 1;
+}
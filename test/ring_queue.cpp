@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2022, suncloudsmoon and the tree-cpp contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "../include/std/zl_ring_queue.hpp"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+/* Stress test + throughput benchmark of zl::spsc_ring and zl::mpmc_ring.
+   Build: make bin/ring_queue */
+
+static constexpr uint64_t messages = 20'000'000;
+static constexpr size_t batch = 32;
+static constexpr int producers = 4;
+static constexpr int consumers = 4;
+
+static double now_sec() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+/* Waiting side yields as well, so the test also makes progress when threads share a core */
+static void spin() {
+	__builtin_ia32_pause();
+	sched_yield();
+}
+
+static zl::spsc_ring<uint64_t, 4096> spsc;
+static zl::mpmc_ring<uint64_t, 4096> mpmc;
+
+struct spsc_args {
+	bool batched;
+	bool ok;
+};
+static void* spsc_producer(void *arg) {
+	const bool batched = static_cast<spsc_args*>(arg)->batched;
+	uint64_t next = 0;
+	uint64_t buf[batch];
+	while (next < messages) {
+		if (batched) {
+			size_t n = 0;
+			for (; n < batch && next + n < messages; n++) { buf[n] = next + n; }
+			size_t done = 0;
+			while (done < n) {
+				const size_t pushed = spsc.push_batch(buf + done, n - done);
+				if (!pushed) spin();
+				done += pushed;
+			}
+			next += n;
+		} else {
+			while (!spsc.try_push(next)) { spin(); }
+			next++;
+		}
+	}
+	return nullptr;
+}
+static void* spsc_consumer(void *arg) {
+	auto *args = static_cast<spsc_args*>(arg);
+	uint64_t expect = 0;
+	uint64_t buf[batch];
+	args->ok = true;
+	while (expect < messages) {
+		if (args->batched) {
+			const size_t n = spsc.pop_batch(buf, batch);
+			if (!n) spin();
+			for (size_t i = 0; i < n; i++) { args->ok &= (buf[i] == expect++); }
+		} else {
+			uint64_t value;
+			if (!spsc.try_pop(value)) {
+				spin();
+				continue;
+			}
+			args->ok &= (value == expect++);
+		}
+	}
+	return nullptr;
+}
+
+static bool run_spsc(bool batched) {
+	spsc_args args{ batched, false };
+	pthread_t prod, cons;
+	const double start = now_sec();
+	pthread_create(&cons, nullptr, spsc_consumer, &args);
+	pthread_create(&prod, nullptr, spsc_producer, &args);
+	pthread_join(prod, nullptr);
+	pthread_join(cons, nullptr);
+	const double secs = now_sec() - start;
+	printf("zl::spsc_ring (%s): %6.1f M msg/s, order %s\n", batched ? "batch" : "single", 
+			messages / secs / 1e6, args.ok ? "ok" : "BROKEN");
+	return args.ok && !spsc.size_approx();
+}
+
+struct mpmc_args {
+	int id;
+	bool batched;
+	uint64_t count;
+	uint64_t sum;
+	bool ok;
+};
+/* Each producer sends (id << 40 | seq); every consumer must see each producer's values in order */
+static void* mpmc_producer(void *arg) {
+	const auto *args = static_cast<mpmc_args*>(arg);
+	const uint64_t per_producer = messages / producers;
+	const uint64_t tag = static_cast<uint64_t>(args->id) << 40;
+	uint64_t next = 0;
+	uint64_t buf[batch];
+	while (next < per_producer) {
+		if (args->batched) {
+			size_t n = 0;
+			for (; n < batch && next + n < per_producer; n++) { buf[n] = tag | (next + n); }
+			size_t done = 0;
+			while (done < n) {
+				const size_t pushed = mpmc.push_batch(buf + done, n - done);
+				if (!pushed) spin();
+				done += pushed;
+			}
+			next += n;
+		} else {
+			while (!mpmc.try_push(tag | next)) { spin(); }
+			next++;
+		}
+	}
+	return nullptr;
+}
+static uint64_t mpmc_consumed;
+static void* mpmc_consumer(void *arg) {
+	auto *args = static_cast<mpmc_args*>(arg);
+	uint64_t last[producers];
+	for (int i = 0; i < producers; i++) { last[i] = ~0ull; }
+	uint64_t buf[batch];
+	args->ok = true;
+	while (__atomic_load_n(&mpmc_consumed, __ATOMIC_RELAXED) < messages) {
+		const size_t n = args->batched ? mpmc.pop_batch(buf, batch) : mpmc.try_pop(buf[0]);
+		if (!n) {
+			spin();
+			continue;
+		}
+		for (size_t i = 0; i < n; i++) {
+			const int from = static_cast<int>(buf[i] >> 40);
+			const uint64_t seq = buf[i] & ((1ull << 40) - 1);
+			args->ok &= (last[from] == ~0ull) || (seq > last[from]);
+			last[from] = seq;
+			args->sum += seq;
+		}
+		args->count += n;
+		__atomic_fetch_add(&mpmc_consumed, n, __ATOMIC_RELAXED);
+	}
+	return nullptr;
+}
+
+static bool run_mpmc(bool batched) {
+	mpmc_args prod_args[producers], cons_args[consumers];
+	pthread_t prod[producers], cons[consumers];
+	mpmc_consumed = 0;
+	const double start = now_sec();
+	for (int i = 0; i < consumers; i++) {
+		cons_args[i] = { i, batched, 0, 0, false };
+		pthread_create(&cons[i], nullptr, mpmc_consumer, &cons_args[i]);
+	}
+	for (int i = 0; i < producers; i++) {
+		prod_args[i] = { i, batched, 0, 0, false };
+		pthread_create(&prod[i], nullptr, mpmc_producer, &prod_args[i]);
+	}
+	for (int i = 0; i < producers; i++) { pthread_join(prod[i], nullptr); }
+	for (int i = 0; i < consumers; i++) { pthread_join(cons[i], nullptr); }
+	const double secs = now_sec() - start;
+
+	const uint64_t per_producer = messages / producers;
+	uint64_t count = 0, sum = 0;
+	bool ok = true;
+	for (int i = 0; i < consumers; i++) {
+		count += cons_args[i].count;
+		sum += cons_args[i].sum;
+		ok &= cons_args[i].ok;
+	}
+	ok &= (count == per_producer * producers) && (sum == producers * (per_producer * (per_producer - 1) / 2));
+	printf("zl::mpmc_ring (%s, %dP/%dC): %6.1f M msg/s, delivery %s\n", batched ? "batch" : "single", 
+			producers, consumers, count / secs / 1e6, ok ? "ok" : "BROKEN");
+	return ok && !mpmc.size_approx();
+}
+
+int main() {
+	bool ok = true;
+	ok &= run_spsc(false);
+	ok &= run_spsc(true);
+	ok &= run_mpmc(false);
+	ok &= run_mpmc(true);
+	return ok ? 0 : 1;
+}